@@ -12,24 +12,68 @@
 #include <calib3d/calib3d.hpp>
 // #include "calibrationFunctions.cpp"
 #include "calibrationFunctions.h"
+#include "calibrationLibrary.h"
 
 using namespace std;
 using namespace cv;
 
+/**
+ * @brief Calibrate from high resolution still images given on the command line, e.g. phone photos
+ * 
+ * @param files     calibration images
+ * @param csv_file  csv file that receives the camera matrix and distortion coefficient
+ */
+int calibrate_still_images(const vector<string> &files, const string &csv_file) {
+    calib::ChessboardDetector detector;
+    calib::CameraCalibrator calibrator;
+    Size image_size;
+    int views_added;
+    int images_skipped;
+
+    calib::CalibStatus status = calib::add_calibration_images(files, detector, calibrator, image_size,
+                                                                views_added, images_skipped);
+    if (status != calib::CALIB_OK) {
+        cout << "None of the calibration images could be read" << endl;
+        return(-1);
+    }
+    if (images_skipped > 0) {
+        cout << images_skipped << " images skipped, unreadable or not " << image_size.width << "x" << image_size.height << endl;
+    }
+    cout << "Chessboard found in " << views_added << " of " << files.size() << " images" << endl;
+
+    calib::CameraIntrinsics intrinsics;
+    double RMS_reprojection_error;
+    status = calibrator.calibrate(image_size, intrinsics, RMS_reprojection_error);
+    if (status == calib::CALIB_OK) status = calib::save_intrinsics_csv(csv_file, intrinsics);
+    if (status != calib::CALIB_OK) {
+        cout << "Calibration failed: " << calib::status_string(status) << endl;
+        return(-1);
+    }
+
+    cout << endl << "RMS re-projection error: " <<  RMS_reprojection_error << endl;
+    cout << "Camera matrix:" << endl << intrinsics.camera_matrix << endl;
+    cout << "Distortion coefficient: " << intrinsics.dis_coef << endl;
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
 
     VideoCapture *capdev;
     string csv_name = "data.csv";
     char* csv_file = &csv_name[0];
 
+    // Extension: high resolution still images passed as arguments are calibrated without the camera
+    if (argc > 1) {
+        return calibrate_still_images(vector<string>(argv + 1, argv + argc), csv_name);
+    }
+
     Size pattern_size(9, 6);
     vector<Point2f> corner_set;
 	vector<vector<Point2f>> corner_list;
     vector<Vec3f> point_set;
 	vector<vector<Vec3f>> point_list;
     
-    vector<Vec3f> v_vec;
-    vector<int> v_idx;
+    unique_ptr<calib::MeshRenderer> cow_renderer;
 
     bool isCalibrated = false;
     bool positionCalculated = false;
@@ -37,6 +81,14 @@ int main(int argc, char *argv[]) {
     bool isProjected = false;
     bool isCow = false;
     bool isStatic = false;
+    bool isMultiTarget = false;
+
+    // Extension: multiple targets, each with its own id and pose
+    unique_ptr<calib::MultiBoardTracker> tracker;
+    unique_ptr<calib::Projector> target_projector;
+    calib::OverlayRegistry overlays;
+    vector<calib::TrackedTarget> targets;
+    Mat multi_target_img;
 
     Mat camera_matrix_read;
     Mat dis_coef_read;
@@ -63,6 +115,7 @@ int main(int argc, char *argv[]) {
             << "After calculateing the rotation matrix and translation matrix, press 'a' to show 3D axes" << endl
             << "After calculateing the rotation matrix and translation matrix, press 'v' to show the virtual object" << endl
             << "After calculateing the rotation matrix and translation matrix, press 'o' to place the virtual cow" << endl // TODO:
+            << "After calibrating the camera, press 'm' to track multiple chessboards, the cow is bound to target 0" << endl
             << "Press 'q' to quit" << endl << endl;
 
     while (true) {
@@ -78,26 +131,29 @@ int main(int argc, char *argv[]) {
         corner_detcted = frame.clone();
         extract_corners(frame, corner_detcted, pattern_size, corner_set);
 
+        if (isMultiTarget) {
+            multi_target_img = frame.clone();
+            tracker->track(frame, targets);
+            for (const calib::TrackedTarget &target: targets) {
+                if (target.pose.rotate_vec.empty()) continue;
+                target_projector->draw_axes(multi_target_img, target.pose);
+                putText(multi_target_img, to_string(target.target_id), target.corner_set[0],
+                        FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 255, 255), 2);
+            }
+            overlays.render(multi_target_img, targets);
+            imshow("Multiple Targets", multi_target_img);
+        }
+
         if (is3DAxes) {
             axes_img = frame.clone();
             PNP_rotate_vec.release();
             PNP_tran_vec.release();
             camera_matrix_read.release();
             dis_coef_read.release();
-            if (corner_set.size() != 54) continue;
-
-            calculate_metrices(csv_file, point_set, corner_set, camera_matrix_read, dis_coef_read, PNP_rotate_vec, PNP_tran_vec);
-            vector<Vec3f> real_world;
-            real_world.push_back(Vec3f(0, 0, 0));
-            real_world.push_back(Vec3f(0, -3, 0));
-            real_world.push_back(Vec3f(3, 0, 0));
-            real_world.push_back(Vec3f(0, 0, 3));
-
-            vector<Point2f> image_points;
-            projectPoints(real_world, PNP_rotate_vec, PNP_tran_vec, camera_matrix_read, dis_coef_read, image_points);
-            line(axes_img, image_points[0], image_points[1], Scalar(0, 0, 255), 2);
-            line(axes_img, image_points[0], image_points[2], Scalar(0, 255, 0), 2);
-            line(axes_img, image_points[0], image_points[3], Scalar(255, 0, 0), 2);
+            if (calculate_metrices(csv_file, pattern_size, corner_set, camera_matrix_read, dis_coef_read, PNP_rotate_vec, PNP_tran_vec) != 0) continue;
+            calib::Projector projector(calib::CameraIntrinsics{camera_matrix_read, dis_coef_read});
+            calib::Pose pose{PNP_rotate_vec, PNP_tran_vec};
+            projector.draw_axes(axes_img, pose);
             imshow("3D Axes", axes_img);
 
         }
@@ -108,9 +164,9 @@ int main(int argc, char *argv[]) {
             PNP_tran_vec.release();
             camera_matrix_read.release();
             dis_coef_read.release();
-            if (corner_set.size() != 54) continue;
-
-            calculate_metrices(csv_file, point_set, corner_set, camera_matrix_read, dis_coef_read, PNP_rotate_vec, PNP_tran_vec);
+            if (calculate_metrices(csv_file, pattern_size, corner_set, camera_matrix_read, dis_coef_read, PNP_rotate_vec, PNP_tran_vec) != 0) continue;
+            calib::Projector projector(calib::CameraIntrinsics{camera_matrix_read, dis_coef_read});
+            calib::Pose pose{PNP_rotate_vec, PNP_tran_vec};
             vector<Vec3f> real_world;
             real_world.push_back(Vec3f(1, -1, 0));
             real_world.push_back(Vec3f(1, -5, 0));
@@ -119,7 +175,7 @@ int main(int argc, char *argv[]) {
             real_world.push_back(Vec3f(3, -3, 4));
 
             vector<Point2f> image_points;
-            projectPoints(real_world, PNP_rotate_vec, PNP_tran_vec, camera_matrix_read, dis_coef_read, image_points);
+            projector.project(real_world, pose, image_points);
             for (int i = 0; i < image_points.size(); i++) {
                 for (int j = 0; j < image_points.size(); j++) {
                     line(projected_img, image_points[i], image_points[j], Scalar(0, 0, 255), 2);
@@ -134,17 +190,9 @@ int main(int argc, char *argv[]) {
             PNP_tran_vec.release();
             camera_matrix_read.release();
             dis_coef_read.release();
-            if (corner_set.size() != 54) continue;
-
-            calculate_metrices(csv_file, point_set, corner_set, camera_matrix_read, dis_coef_read, PNP_rotate_vec, PNP_tran_vec);
-
-            vector<Point2f> image_points;
-            projectPoints(v_vec, PNP_rotate_vec, PNP_tran_vec, camera_matrix_read, dis_coef_read, image_points);
-            for (int i = 0; i < v_idx.size(); i+=3) {
-                line(projected_cow, image_points[v_idx[i] - 1], image_points[v_idx[i + 1] - 1], Scalar(0, 0, 255), 1);
-                line(projected_cow, image_points[v_idx[i + 1] - 1], image_points[v_idx[i + 2] - 1], Scalar(0, 0, 255), 1);
-                line(projected_cow, image_points[v_idx[i + 2] - 1], image_points[v_idx[i] - 1], Scalar(0, 0, 255), 1);
-            }
+            if (calculate_metrices(csv_file, pattern_size, corner_set, camera_matrix_read, dis_coef_read, PNP_rotate_vec, PNP_tran_vec) != 0) continue;
+            calib::Pose pose{PNP_rotate_vec, PNP_tran_vec};
+            cow_renderer->render(projected_cow, pose);
             imshow("Cow", projected_cow);
         }
 
@@ -154,7 +202,7 @@ int main(int argc, char *argv[]) {
         }
         // Task 2: Save the corner locations and the corresponding 3D world points.
         else if (k == 's') {
-            record_coordinates(point_set, point_list, corner_set, corner_list);
+            record_coordinates(pattern_size, point_set, point_list, corner_set, corner_list);
         }
         // Task 3: Calibrate the Camera
         else if (k == 'c') {
@@ -162,24 +210,23 @@ int main(int argc, char *argv[]) {
                 cout << "No enough calibration images input, at least 5 images needed. Current # of images: " << corner_list.size() << endl;
             }
             else {
-                double camera_matrix_2Darray[3][3] = {
-                                                        {1, 0, (double)frame.cols/2},
-                                                        {0, 1, (double)frame.rows/2}, 
-                                                        {0, 0, 1}};
-                Mat camera_matrix = Mat(3, 3, CV_64FC1, &camera_matrix_2Darray);
+                Mat camera_matrix;
                 double RMS_reprojection_error;
                 Mat dis_coef;
-                vector<Mat> rotate_vec;
-                vector<Mat> tran_vec;
 
-                calibrate_camera(csv_file, RMS_reprojection_error, point_list, corner_list, frame, camera_matrix, dis_coef, rotate_vec, tran_vec);
-                isCalibrated = true;
+                if (calibrate_camera(csv_file, pattern_size, corner_list, frame.size(), RMS_reprojection_error, camera_matrix, dis_coef) == 0) {
+                    isCalibrated = true;
+                }
             }
         }
         // Task 4: Calculate Current Position of the Camera
         else if (k == 'p') {
             if (isCalibrated) {
-                calculate_metrices(csv_file, point_set, corner_set, camera_matrix_read, dis_coef_read, PNP_rotate_vec, PNP_tran_vec);
+                int status = calculate_metrices(csv_file, pattern_size, corner_set, camera_matrix_read, dis_coef_read, PNP_rotate_vec, PNP_tran_vec);
+                if (status != 0) {
+                    cout << "Unable to calculate the position: " << calib::status_string((calib::CalibStatus)status) << endl;
+                    continue;
+                }
                 positionCalculated = true;
 
                 cout << endl << "Camera matrix read:" << endl;
@@ -226,27 +273,35 @@ int main(int argc, char *argv[]) {
                 cout << "Rotation matrix and translation matrix is not calculated, press 'p' to calculate" << endl; 
             }
         }
+        // Extension: track multiple chessboards
+        else if (k == 'm') {
+            calib::CameraIntrinsics intrinsics;
+            if (isCalibrated && calib::load_intrinsics_csv(csv_name, intrinsics) == calib::CALIB_OK) {
+                tracker.reset(new calib::MultiBoardTracker(intrinsics));
+                target_projector.reset(new calib::Projector(intrinsics));
+                shared_ptr<calib::MeshRenderer> cow(new calib::MeshRenderer(intrinsics));
+                if (cow->load_obj("cow.obj") == calib::CALIB_OK) overlays.bind(0, cow);
+                isMultiTarget = true;
+            }
+            else {
+                cout << "Camera is not calibrated, press 'c' to calibrate the camera" << endl;
+            }
+        }
         // Extension: deal with static images
         else if (k == 'o') {
             if(positionCalculated) {
-                string obj_name = "cow.obj";
-                char *obj_file = &obj_name[0];
-                read_obj_file(obj_file, v_vec, v_idx);
-                double min_0 = 99;
-                double max_1 = -99;
-                double min_2 = 99;
-                // add some offset to make it at the middle
-                for (Vec3f &it: v_vec) {
-                    if (it[0] < min_0) min_0 = it[0];
-                    if (it[1] > max_1) max_1 = it[1];
-                    if (it[2] < min_2) min_2 = it[2];
+                calib::CameraIntrinsics intrinsics;
+                calib::CalibStatus status = calib::load_intrinsics_csv(csv_name, intrinsics);
+                if (status == calib::CALIB_OK) {
+                    cow_renderer.reset(new calib::MeshRenderer(intrinsics));
+                    status = cow_renderer->load_obj("cow.obj");
+                }
+                if (status == calib::CALIB_OK) {
+                    isCow = true;
                 }
-                for (auto &it: v_vec) {
-                    it[0] += abs(min_0);
-                    it[1] -= max_1;
-                    it[2] += abs(min_2);
+                else {
+                    cout << "Unable to load cow.obj: " << calib::status_string(status) << endl;
                 }
-                isCow = true;
             }
             else {
                 cout << "Rotation matrix and translation matrix is not calculated, press 'p' to calculate" << endl;
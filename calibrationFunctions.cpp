@@ -3,16 +3,27 @@
  * @author Xichen Liu
  * @brief 
  * Includes the functions used in CalibrationNAR.cpp
+ * The computations are done by calibrationLibrary.cpp, the functions here add the windows and console output.
  */
 
 
 #include <stdio.h>
 #include <opencv.hpp>
 #include <calib3d/calib3d.hpp>
+#include "calibrationLibrary.h"
 
 using namespace std;
 using namespace cv;
 
+/**
+ * @brief Board geometry of the given pattern size, one world unit per square
+ */
+static calib::BoardSpec board_of(Size pattern_size) {
+    calib::BoardSpec board;
+    board.pattern_size = pattern_size;
+    return board;
+}
+
 /**
  * @brief Detect and Extract Chessboard Corners
  * 
@@ -21,233 +32,74 @@ using namespace cv;
  * @param corner_set    poxision of corners
  */
 void extract_corners(Mat frame, Mat &corner_detcted, Size pattern_size, vector<Point2f> &corner_set) {
-    corner_set.clear();
-    bool pattern_found = findChessboardCorners(frame, pattern_size, corner_set);
-    Mat gray;
-    cvtColor(frame, gray, COLOR_BGR2GRAY);
-    if (pattern_found) {
-        cornerSubPix(gray, corner_set, Size(11, 11), Size(-1, -1),
-            TermCriteria(TermCriteria::EPS + TermCriteria::COUNT, 50, 0.1));
-    }
-    drawChessboardCorners(corner_detcted, pattern_size, Mat(corner_set), pattern_found);
+    calib::ChessboardDetector detector(board_of(pattern_size));
+    bool pattern_found = detector.detect(frame, corner_set) == calib::CALIB_OK;
+    detector.draw(corner_detcted, corner_set, pattern_found);
     imshow("Detect and Extract Chessboard Corners", corner_detcted);
 }
 
 /**
  * @brief Save the corner locations and the corresponding 3D world points.
  * 
+ * @param pattern_size  size of corners
  * @param point_set     world coordinates of a single image
  * @param point_list    world coordinates of all calibration images
  * @param corner_set    corner coordinates of a single image
  * @param corner_list   corner coordinates of all calibration images
  */
-void record_coordinates(vector<Vec3f> &point_set, vector<vector<Vec3f>> &point_list, 
+void record_coordinates(Size pattern_size, vector<Vec3f> &point_set, vector<vector<Vec3f>> &point_list, 
                         vector<Point2f> corner_set, vector<vector<Point2f>> &corner_list) {
     
-    int point_list_size = point_list.size();
-    int corner_list_size = corner_list.size();
+    if ((int)corner_set.size() != pattern_size.area()) {
+        cout << "Chessboard not found in the current frame, nothing recorded" << endl;
+        return;
+    }
 
     cout << endl << "Frame " << corner_list.size() << ":" << endl;
 
-    point_set.clear();
-    for (int i = 0; i > -6; i--) {
-        for (int j = 0; j < 9; j++) {
-            point_set.push_back(Vec3f(j, i, 0));
-        }
-    }
+    point_set = board_of(pattern_size).object_points();
     point_list.push_back(point_set);
     corner_list.push_back(corner_set);
 
     cout << endl << "World coordinates:" << endl;
-    for (int j = 0; j < point_list[point_list_size].size(); j++) {
-        cout << point_list[point_list_size][j] << " ";
-        if ((j + 1) % 9 == 0) cout << endl;
+    for (int j = 0; j < point_set.size(); j++) {
+        cout << point_set[j] << " ";
+        if ((j + 1) % pattern_size.width == 0) cout << endl;
     }
     cout << "corner coordinates:" << endl;
-    for (int j = 0; j < corner_list[corner_list_size].size(); j++) {
-        cout << corner_list[corner_list_size][j] << " ";
-        if ((j + 1) % 9 == 0) cout << endl;
+    for (int j = 0; j < corner_set.size(); j++) {
+        cout << corner_set[j] << " ";
+        if ((j + 1) % pattern_size.width == 0) cout << endl;
     }
     cout << "Finish Recording" << endl;
 }
 
 /**
- * @brief Append the camera matrix and the distortion ceofficients to csv file
- * 
- * @param filename      name of csv file name
- * @param matrix        input parameters
- * @param reset_file    determine whether the current content of csv will be earsed
- */
-void append_parameters_csv(char *filename, Mat matrix, int reset_file) {
-    char mode[8];
-    FILE *fp;
-
-    strcpy(mode, "a");
-
-    if (reset_file) {
-        strcpy(mode, "w");
-    }
-
-    fp = fopen(filename, mode);
-    if (!fp) {
-        printf("Unable to open output file %s\n", filename);
-        exit(-1);
-    }
-
-    for (int i = 0; i < matrix.rows; i++) {
-        for (int j = 0; j < matrix.cols; j++) {
-            if (i == 0 && j == 0) {
-                char buffer[256];
-                sprintf(buffer, "%.4f", matrix.at<double>(i, j));
-                fwrite(buffer, sizeof(char), strlen(buffer), fp);
-            }
-            else {
-                char buffer[256];
-                sprintf(buffer, ",%.4f", matrix.at<double>(i, j));
-                fwrite(buffer, sizeof(char), strlen(buffer), fp);
-            }
-        }
-    }
-        
-    fwrite("\n", sizeof(char), 1, fp); // EOL
-
-    fclose(fp);
-}
-
-int getstring(FILE *fp, char os[]) {
-    int p = 0;
-    int eol = 0;
-    
-    for (;;) {
-        char ch = fgetc(fp);
-        if (ch == ',') {
-            break;
-        }
-        else if (ch == '\n' || ch == EOF) {
-            eol = 1;
-            break;
-        }
-        // printf("%c", ch ); // uncomment for debugging
-        os[p] = ch;
-        p++;
-    }
-    
-    // printf("\n"); // uncomment for debugging
-    os[p] = '\0';
-
-    return eol; // return true if eol
-}
-
-int getint(FILE *fp, int *v) {
-    char s[256];
-    int p = 0;
-    int eol = 0;
-
-    for (;;) {
-        char ch = fgetc(fp);
-
-        if (ch == ',') {
-            break;
-        }
-        else if (ch == '\n' || ch == EOF) {
-            eol = 1;
-            break;
-        }
-        
-        s[p] = ch;
-        p++;
-    }
-
-    s[p] = '\0'; // terminator
-    *v = atoi(s);
-
-    return eol; // return true if eol
-}
-
-int getfloat(FILE *fp, float *v) {
-    char s[256];
-    int p = 0;
-    int eol = 0;
-
-    for (;;) {
-        char ch = fgetc(fp);
-
-        if (ch == ',') {
-            break;
-        }
-        else if (ch == '\n' || ch == EOF) {
-            eol = 1;
-            break;
-        }
-        
-        s[p] = ch;
-        p++;
-    }
-
-    s[p] = '\0'; // terminator
-    *v = atof(s);
-
-    return eol; // return true if eol
-}
-
-/**
- * @brief Read camera matrix and distortion coefficients from the csv file
+ * @brief Calibrate the Camera and save the camera matrix and distortion coefficient to the csv file
  * 
- * @param filename  name of csv file
- * @param data      vector that stores camera matrix and distortion coefficients
+ * @param csv_file                  csv file that stores the info of camera matrix and distortion coefficient
+ * @param pattern_size              size of corners
+ * @param corner_list               Corners in the image coordinates
+ * @param image_size                size of the calibration images
+ * @param RMS_reprojection_error    The overall RMS re-projection error.
+ * @param camera_matrix             Output 3x3 floating-point camera intrinsic matrix
+ * @param dis_coef                  Output vector of distortion coefficients
+ * @return                          0 on success, -1 if calibration or writing the csv file failed
  */
-int read_image_data_csv(char *filename, vector<vector<float>> &data) {
-    FILE *fp;
-    float fval;
-    int iter = 0;
-
-    fp = fopen(filename, "r");
-    if (!fp) {
-        printf("Unable to open feature file\n");
+int calibrate_camera(char* csv_file, Size pattern_size, vector<vector<Point2f>> corner_list, Size image_size,
+                        double &RMS_reprojection_error, Mat &camera_matrix, Mat &dis_coef) {
+    calib::CameraCalibrator calibrator(board_of(pattern_size));
+    for (const vector<Point2f> &corner_set: corner_list) calibrator.add_view(corner_set);
+
+    calib::CameraIntrinsics intrinsics;
+    calib::CalibStatus status = calibrator.calibrate(image_size, intrinsics, RMS_reprojection_error);
+    if (status == calib::CALIB_OK) status = calib::save_intrinsics_csv(csv_file, intrinsics);
+    if (status != calib::CALIB_OK) {
+        cout << "Calibration failed: " << calib::status_string(status) << endl;
         return(-1);
     }
-
-    for (;;) {
-        vector<float> dvec;
-
-        for (;;) {
-            // get next feature
-            float eol = getfloat(fp, &fval);
-            dvec.push_back(fval);
-            if (eol) {
-                iter++;
-                break;
-            }
-        }
-
-        data.push_back(dvec);
-
-        // stop after the 2nd iteration, because only camera matrix and distortion coefficients need to be extracted 
-        if (iter == 2) break;
-    }
-    fclose(fp);
-
-    return 0;
-}
-
-/**
- * @brief Calibrate the Camera
- * 
- * @param RMS_reprojection_error    The overall RMS re-projection error.
- * @param point_list                Points in the world coordinates
- * @param corner_list               Corners in the image coordinates
- * @param frame                     Image
- * @param camera_matrix             Input/output 3x3 floating-point camera intrinsic matrix
- * @param dis_coef                  Input/output vector of distortion coefficients
- * @param rotate_vec                Output vector of rotation vectors (Rodrigues) estimated for each pattern view
- * @param tran_vec                  Output vector of translation vectors estimated for each pattern view
- */
-void calibrate_camera(char* csv_file, double &RMS_reprojection_error, vector<vector<Vec3f>> point_list, 
-                        vector<vector<Point2f>> corner_list, Mat frame, Mat &camera_matrix, 
-                        Mat &dis_coef, vector<Mat> &rotate_vec, vector<Mat> &tran_vec) {
-
-    RMS_reprojection_error = calibrateCamera(point_list, corner_list, frame.size(), camera_matrix, 
-                                                dis_coef, rotate_vec, tran_vec, CALIB_FIX_ASPECT_RATIO);
+    camera_matrix = intrinsics.camera_matrix;
+    dis_coef = intrinsics.dis_coef;
 
     cout << endl << "RMS re-projection error: " <<  RMS_reprojection_error << endl;
     cout << "Camera matrix:" << endl;
@@ -259,61 +111,37 @@ void calibrate_camera(char* csv_file, double &RMS_reprojection_error, vector<vec
     }
     cout << "Distortion coefficient: " << dis_coef << endl;
 
-    append_parameters_csv(csv_file, camera_matrix, 1);
-    append_parameters_csv(csv_file, dis_coef, 0);
+    return 0;
 }
 
 /**
  * @brief Calculate Current Position of the Camera
  * 
  * @param csv_file              csv file that stores the info of camera matrix and distortion coefficient
- * @param point_set             real world coordinates
+ * @param pattern_size          size of corners
  * @param corner_set            corner coordinates in image
  * @param camera_matrix_read    camera matrix read from csv file
  * @param dis_coef_read         distortion coefficient read from csv file
  * @param PNP_rotate_vec        rotation matrix
  * @param PNP_tran_vec          translation matrix
+ * @return                      0 on success, otherwise the calib::CalibStatus of the step that failed
  */
-void calculate_metrices(char* csv_file, vector<Vec3f> &point_set, vector<Point2f> corner_set, 
+int calculate_metrices(char* csv_file, Size pattern_size, vector<Point2f> corner_set, 
                         Mat &camera_matrix_read, Mat &dis_coef_read, Mat &PNP_rotate_vec, Mat &PNP_tran_vec) {
-    // read camera matrix and distortion coefficient from csv file
-    double camera_matrix_2Darray_read[3][3];
-    double dis_coef_2Darray_read[1][5];
-    vector<vector<float>> parameters;
-
-    read_image_data_csv(csv_file, parameters);
-    int c = 0;
-    while (c < parameters[0].size()) {
-        for (int i = 0; i < 3; i++) {
-            for (int j = 0; j < 3; j++) {
-                camera_matrix_2Darray_read[i][j] = parameters[0][c];
-                c++;
-            }
-        }
-    }
-    c = 0;
-    while (c < parameters[1].size()) {
-        for (int i = 0; i < 1; i++) {
-            for (int j = 0; j < 5; j++) {
-                dis_coef_2Darray_read[i][j] = parameters[1][c];
-                c++;
-            }
-        }
-    }
-    camera_matrix_read = Mat(3, 3, CV_64FC1, &camera_matrix_2Darray_read);
-    dis_coef_read = Mat(1, 5, CV_64FC1, &dis_coef_2Darray_read);
-
-    point_set.clear();
-    for (int i = 0; i > -6; i--) {
-        for (int j = 0; j < 9; j++) {
-            point_set.push_back(Vec3f(j, i, 0));
-        }
-    }
-    
-    solvePnP(point_set, corner_set, camera_matrix_read, dis_coef_read, PNP_rotate_vec, PNP_tran_vec);
-
-    camera_matrix_read = camera_matrix_read.clone();
-    dis_coef_read = dis_coef_read.clone();
+    calib::CameraIntrinsics intrinsics;
+    calib::CalibStatus status = calib::load_intrinsics_csv(csv_file, intrinsics);
+    if (status != calib::CALIB_OK) return status;
+    camera_matrix_read = intrinsics.camera_matrix;
+    dis_coef_read = intrinsics.dis_coef;
+
+    if ((int)corner_set.size() != pattern_size.area()) return calib::CALIB_ERR_PATTERN_NOT_FOUND;
+    calib::PoseEstimator estimator(intrinsics, board_of(pattern_size));
+    calib::Pose pose;
+    status = estimator.estimate(corner_set, pose);
+    if (status != calib::CALIB_OK) return status;
+    PNP_rotate_vec = pose.rotate_vec;
+    PNP_tran_vec = pose.tran_vec;
+    return 0;
 }
 
 /**
@@ -342,6 +170,7 @@ void Harris_corners(Mat src, Mat &dst, int block_size, int aperture_size, double
     dst = dst_norm_scaled.clone();
 }
 
+
 /**
  * @brief Read positions of the vertices
  * 
@@ -350,34 +179,13 @@ void Harris_corners(Mat src, Mat &dst, int block_size, int aperture_size, double
  * @param v_idx         surfaces that consist of vertices
  */
 int read_obj_file(char *file_name, vector<Vec3f> &v_vec, vector<int> &v_idx) {
-    FILE *file = fopen(file_name, "r");
-    if( file == NULL ){
-        printf("Impossible to open the file !n");
+    calib::Mesh mesh;
+    calib::CalibStatus status = calib::read_obj_mesh(file_name, mesh);
+    if (status != calib::CALIB_OK) {
+        printf("Unable to read %s: %s\n", file_name, calib::status_string(status));
         return (-1);
     }
-    while(true){
-        char lineHeader[128];
-        // read the first word of the line
-        int res = fscanf(file, "%s", lineHeader);
-        if (res == EOF)
-            break;
-        if (strcmp( lineHeader, "v") == 0){
-            Vec3f vertex;
-            fscanf(file, "%f %f %f/n", &vertex[0], &vertex[2], &vertex[1]);
-            v_vec.push_back(vertex);
-        }
-        else if (strcmp(lineHeader, "f") == 0 ){
-            std::string vertex1, vertex2, vertex3;
-            unsigned int vertexIndex[3];
-            int matches = fscanf(file, "%d %d %d/n", &vertexIndex[0], &vertexIndex[1], &vertexIndex[2]);
-            if (matches != 3){
-                printf("File can't be read by our simple parser : (Try exporting with other optionsn");
-                return false;
-            }
-            v_idx.push_back(vertexIndex[0]);
-            v_idx.push_back(vertexIndex[1]);
-            v_idx.push_back(vertexIndex[2]);
-        }
-    }
+    v_vec = mesh.v_vec;
+    v_idx = mesh.v_idx;
     return 0;
 }
@@ -0,0 +1,805 @@
+/**
+ * @file calibrationLibrary.cpp
+ * @author Xichen Liu
+ * @brief
+ * Implementation of the reentrant calibration and AR library declared in calibrationLibrary.h
+ */
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calibrationLibrary.h"
+
+using namespace std;
+using namespace cv;
+
+namespace calib {
+
+const char *status_string(CalibStatus status) {
+    switch (status) {
+        case CALIB_OK:                      return "ok";
+        case CALIB_ERR_EMPTY_IMAGE:         return "empty image";
+        case CALIB_ERR_PATTERN_NOT_FOUND:   return "chessboard pattern not found";
+        case CALIB_ERR_BAD_ARGUMENT:        return "bad argument";
+        case CALIB_ERR_NOT_ENOUGH_VIEWS:    return "not enough calibration views";
+        case CALIB_ERR_NOT_CALIBRATED:      return "camera is not calibrated";
+        case CALIB_ERR_FILE_IO:             return "unable to open file";
+        case CALIB_ERR_PARSE:               return "unable to parse file";
+        case CALIB_ERR_SOLVER:              return "solver failed";
+    }
+    return "unknown status";
+}
+
+vector<Vec3f> BoardSpec::object_points() const {
+    vector<Vec3f> point_set;
+    point_set.reserve(pattern_size.area());
+    for (int i = 0; i < pattern_size.height; i++) {
+        for (int j = 0; j < pattern_size.width; j++) {
+            point_set.push_back(Vec3f(j * square_size, -i * square_size, 0));
+        }
+    }
+    return point_set;
+}
+
+bool CameraIntrinsics::valid() const {
+    return camera_matrix.rows == 3 && camera_matrix.cols == 3 && camera_matrix.type() == CV_64FC1;
+}
+
+CameraIntrinsics CameraIntrinsics::clone() const {
+    CameraIntrinsics copy;
+    copy.camera_matrix = camera_matrix.clone();
+    copy.dis_coef = dis_coef.clone();
+    return copy;
+}
+
+/**
+ * @brief Write one matrix as a single comma separated row
+ */
+static void write_matrix_row(FILE *fp, const Mat &matrix) {
+    Mat values;
+    matrix.convertTo(values, CV_64FC1);
+    for (int i = 0; i < values.rows; i++) {
+        for (int j = 0; j < values.cols; j++) {
+            fprintf(fp, (i == 0 && j == 0) ? "%.10g" : ",%.10g", values.at<double>(i, j));
+        }
+    }
+    fprintf(fp, "\n");
+}
+
+/**
+ * @brief Read one comma separated row of doubles, returns false at end of file
+ */
+static bool read_matrix_row(FILE *fp, vector<double> &values) {
+    char line[4096];
+    values.clear();
+    if (!fgets(line, sizeof(line), fp)) return false;
+
+    char *cursor = line;
+    while (*cursor != '\0' && *cursor != '\n' && *cursor != '\r') {
+        char *end;
+        double value = strtod(cursor, &end);
+        if (end == cursor) return false;
+        values.push_back(value);
+        cursor = end;
+        if (*cursor == ',') cursor++;
+    }
+    return true;
+}
+
+CalibStatus save_intrinsics_csv(const string &filename, const CameraIntrinsics &intrinsics) {
+    if (!intrinsics.valid()) return CALIB_ERR_NOT_CALIBRATED;
+
+    FILE *fp = fopen(filename.c_str(), "w");
+    if (!fp) return CALIB_ERR_FILE_IO;
+    write_matrix_row(fp, intrinsics.camera_matrix);
+    write_matrix_row(fp, intrinsics.dis_coef);
+    fclose(fp);
+    return CALIB_OK;
+}
+
+CalibStatus load_intrinsics_csv(const string &filename, CameraIntrinsics &intrinsics) {
+    FILE *fp = fopen(filename.c_str(), "r");
+    if (!fp) return CALIB_ERR_FILE_IO;
+
+    vector<double> camera_values;
+    vector<double> dis_values;
+    bool ok = read_matrix_row(fp, camera_values) && read_matrix_row(fp, dis_values);
+    fclose(fp);
+    if (!ok || camera_values.size() != 9 || dis_values.empty()) return CALIB_ERR_PARSE;
+
+    intrinsics.camera_matrix = Mat(3, 3, CV_64FC1, camera_values.data()).clone();
+    intrinsics.dis_coef = Mat(1, (int)dis_values.size(), CV_64FC1, dis_values.data()).clone();
+    return CALIB_OK;
+}
+
+/**
+ * @brief Convert an 8-bit BGR, BGRA or grayscale frame to grayscale, other formats are rejected
+ */
+static CalibStatus to_gray(const Mat &frame, Mat &gray) {
+    if (frame.empty()) return CALIB_ERR_EMPTY_IMAGE;
+    if (frame.depth() != CV_8U) return CALIB_ERR_BAD_ARGUMENT;
+
+    switch (frame.channels()) {
+        case 1: gray = frame; break;
+        case 3: cvtColor(frame, gray, COLOR_BGR2GRAY); break;
+        case 4: cvtColor(frame, gray, COLOR_BGRA2GRAY); break;
+        default: return CALIB_ERR_BAD_ARGUMENT;
+    }
+    return CALIB_OK;
+}
+
+/**
+ * @brief Mesh faces must be triangles referring to existing vertices (1-based)
+ */
+static bool valid_mesh(const Mesh &mesh) {
+    if (mesh.v_idx.size() % 3 != 0) return false;
+    for (int idx : mesh.v_idx) {
+        if (idx < 1 || idx > (int)mesh.v_vec.size()) return false;
+    }
+    return true;
+}
+
+ChessboardDetector::ChessboardDetector(const BoardSpec &board) : board_(board) {}
+
+CalibStatus ChessboardDetector::detect(const Mat &frame, vector<Point2f> &corner_set, int flags) const {
+    corner_set.clear();
+    Mat gray;
+    CalibStatus status = to_gray(frame, gray);
+    if (status != CALIB_OK) return status;
+
+    try {
+        if (!findChessboardCorners(gray, board_.pattern_size, corner_set, flags)) {
+            corner_set.clear();
+            return CALIB_ERR_PATTERN_NOT_FOUND;
+        }
+        cornerSubPix(gray, corner_set, Size(11, 11), Size(-1, -1),
+            TermCriteria(TermCriteria::EPS + TermCriteria::COUNT, 50, 0.1));
+    }
+    catch (const cv::Exception &) {
+        corner_set.clear();
+        return CALIB_ERR_SOLVER;
+    }
+    return CALIB_OK;
+}
+
+CalibStatus ChessboardDetector::detect_high_res(const Mat &frame, vector<Point2f> &corner_set,
+                                                int max_detect_dim) const {
+    corner_set.clear();
+    if (max_detect_dim <= 0) return CALIB_ERR_BAD_ARGUMENT;
+
+    Mat gray;
+    CalibStatus status = to_gray(frame, gray);
+    if (status != CALIB_OK) return status;
+
+    try {
+        status = refine_high_res(gray, corner_set, max_detect_dim);
+    }
+    catch (const cv::Exception &) {
+        status = CALIB_ERR_SOLVER;
+    }
+    if (status != CALIB_OK) corner_set.clear();
+    return status;
+}
+
+CalibStatus ChessboardDetector::refine_high_res(const Mat &gray, vector<Point2f> &corner_set,
+                                                int max_detect_dim) const {
+    double scale = (double)max(gray.cols, gray.rows) / max_detect_dim;
+    if (scale <= 1.0) return detect(gray, corner_set);
+
+    // find the board on the decimated level
+    Mat small;
+    resize(gray, small, Size(cvRound(gray.cols / scale), cvRound(gray.rows / scale)), 0, 0, INTER_AREA);
+    if (!findChessboardCorners(small, board_.pattern_size, corner_set)) {
+        return CALIB_ERR_PATTERN_NOT_FOUND;
+    }
+    cornerSubPix(small, corner_set, Size(5, 5), Size(-1, -1),
+        TermCriteria(TermCriteria::EPS + TermCriteria::COUNT, 30, 0.1));
+
+    // map to full resolution pixel centers
+    double scale_x = (double)gray.cols / small.cols;
+    double scale_y = (double)gray.rows / small.rows;
+    for (Point2f &corner: corner_set) {
+        corner.x = (float)((corner.x + 0.5) * scale_x - 0.5);
+        corner.y = (float)((corner.y + 0.5) * scale_y - 0.5);
+    }
+
+    // the search window has to cover the decimation error but stay inside one square; it is no smaller
+    // than the one detect() uses, a smaller window measurably loses accuracy
+    double dx = corner_set[1].x - corner_set[0].x;
+    double dy = corner_set[1].y - corner_set[0].y;
+    int square_px = (int)sqrt(dx * dx + dy * dy);
+    int half_win = max(11, cvCeil(max(scale_x, scale_y) * 1.5));
+    half_win = max(2, min(half_win, square_px * 2 / 5));
+    int radius = half_win + 3;
+
+    Rect image_rect(0, 0, gray.cols, gray.rows);
+    TermCriteria criteria(TermCriteria::EPS + TermCriteria::COUNT, 50, 0.01);
+    vector<Point2f> local(1);
+    for (Point2f &corner: corner_set) {
+        Rect tile = Rect(cvFloor(corner.x) - radius, cvFloor(corner.y) - radius, 2 * radius + 1, 2 * radius + 1)
+                    & image_rect;
+        // cornerSubPix needs the tile to hold the whole window
+        if (tile.width < 2 * half_win + 5 || tile.height < 2 * half_win + 5) continue;
+
+        local[0] = Point2f(corner.x - tile.x, corner.y - tile.y);
+        cornerSubPix(gray(tile), local, Size(half_win, half_win), Size(-1, -1), criteria);
+        corner = Point2f(local[0].x + tile.x, local[0].y + tile.y);
+    }
+    return CALIB_OK;
+}
+
+CalibStatus ChessboardDetector::draw(Mat &canvas, const vector<Point2f> &corner_set, bool pattern_found) const {
+    if (canvas.empty()) return CALIB_ERR_EMPTY_IMAGE;
+    try {
+        drawChessboardCorners(canvas, board_.pattern_size, Mat(corner_set), pattern_found);
+    }
+    catch (const cv::Exception &) {
+        return CALIB_ERR_BAD_ARGUMENT;
+    }
+    return CALIB_OK;
+}
+
+CameraCalibrator::CameraCalibrator(const BoardSpec &board, int min_views)
+    : board_(board), min_views_(min_views) {}
+
+CalibStatus CameraCalibrator::add_view(const vector<Point2f> &corner_set) {
+    if ((int)corner_set.size() != board_.pattern_size.area()) return CALIB_ERR_BAD_ARGUMENT;
+    lock_guard<mutex> lock(mutex_);
+    corner_list_.push_back(corner_set);
+    return CALIB_OK;
+}
+
+size_t CameraCalibrator::view_count() const {
+    lock_guard<mutex> lock(mutex_);
+    return corner_list_.size();
+}
+
+void CameraCalibrator::clear() {
+    lock_guard<mutex> lock(mutex_);
+    corner_list_.clear();
+}
+
+CalibStatus CameraCalibrator::calibrate(Size image_size, CameraIntrinsics &intrinsics,
+                                        double &RMS_reprojection_error) const {
+    if (image_size.area() <= 0) return CALIB_ERR_BAD_ARGUMENT;
+
+    // snapshot the views so the solver runs without holding the lock
+    vector<vector<Point2f>> corner_list;
+    {
+        lock_guard<mutex> lock(mutex_);
+        corner_list = corner_list_;
+    }
+    if ((int)corner_list.size() < min_views_) return CALIB_ERR_NOT_ENOUGH_VIEWS;
+
+    vector<vector<Vec3f>> point_list(corner_list.size(), board_.object_points());
+    double camera_matrix_2Darray[3][3] = {
+                                            {1, 0, (double)image_size.width / 2},
+                                            {0, 1, (double)image_size.height / 2},
+                                            {0, 0, 1}};
+    Mat camera_matrix = Mat(3, 3, CV_64FC1, &camera_matrix_2Darray).clone();
+    Mat dis_coef;
+    vector<Mat> rotate_vec;
+    vector<Mat> tran_vec;
+
+    try {
+        RMS_reprojection_error = calibrateCamera(point_list, corner_list, image_size, camera_matrix,
+                                                    dis_coef, rotate_vec, tran_vec, CALIB_FIX_ASPECT_RATIO);
+    }
+    catch (const cv::Exception &) {
+        return CALIB_ERR_SOLVER;
+    }
+
+    intrinsics.camera_matrix = camera_matrix;
+    intrinsics.dis_coef = dis_coef;
+    return CALIB_OK;
+}
+
+CalibStatus add_calibration_images(const vector<string> &files, const ChessboardDetector &detector,
+                                    CameraCalibrator &calibrator, Size &image_size, int &views_added,
+                                    int &images_skipped, int max_detect_dim) {
+    views_added = 0;
+    images_skipped = 0;
+    image_size = Size();
+
+    // views are grouped by image size, only the corners are kept so memory stays bounded by one image
+    struct SizeGroup {
+        Size size;
+        int images;
+        vector<vector<Point2f>> views;
+    };
+    vector<SizeGroup> groups;
+    int images_read = 0;
+    vector<Point2f> corner_set;
+
+    for (const string &file: files) {
+        // decode straight to grayscale in sensor orientation, so portrait and landscape shots share one size
+        Mat gray = imread(file, IMREAD_GRAYSCALE | IMREAD_IGNORE_ORIENTATION);
+        if (gray.empty()) {
+            images_skipped++;
+            continue;
+        }
+        images_read++;
+
+        size_t g = 0;
+        while (g < groups.size() && groups[g].size != gray.size()) g++;
+        if (g == groups.size()) groups.push_back(SizeGroup{gray.size(), 0, {}});
+        groups[g].images++;
+
+        if (detector.detect_high_res(gray, corner_set, max_detect_dim) == CALIB_OK) {
+            groups[g].views.push_back(corner_set);
+        }
+    }
+    if (groups.empty()) return CALIB_ERR_FILE_IO;
+
+    // the size held by the most images is the camera's, an odd first file cannot decide it
+    const SizeGroup *best = &groups[0];
+    for (const SizeGroup &group: groups) {
+        if (group.images > best->images) best = &group;
+    }
+    image_size = best->size;
+    images_skipped += images_read - best->images;
+    for (const vector<Point2f> &view: best->views) {
+        if (calibrator.add_view(view) == CALIB_OK) views_added++;
+    }
+    return CALIB_OK;
+}
+
+PoseEstimator::PoseEstimator(const CameraIntrinsics &intrinsics, const BoardSpec &board)
+    : intrinsics_(intrinsics.clone()), point_set_(board.object_points()) {}
+
+CalibStatus PoseEstimator::estimate(const vector<Point2f> &corner_set, Pose &pose) const {
+    if (!intrinsics_.valid()) return CALIB_ERR_NOT_CALIBRATED;
+    if (corner_set.size() != point_set_.size()) return CALIB_ERR_BAD_ARGUMENT;
+
+    Mat rotate_vec, tran_vec;
+    try {
+        if (!solvePnP(point_set_, corner_set, intrinsics_.camera_matrix, intrinsics_.dis_coef,
+                        rotate_vec, tran_vec)) {
+            return CALIB_ERR_SOLVER;
+        }
+    }
+    catch (const cv::Exception &) {
+        return CALIB_ERR_SOLVER;
+    }
+    pose.rotate_vec = rotate_vec;
+    pose.tran_vec = tran_vec;
+    return CALIB_OK;
+}
+
+Projector::Projector(const CameraIntrinsics &intrinsics) : intrinsics_(intrinsics.clone()) {}
+
+CalibStatus Projector::project(const vector<Vec3f> &world_points, const Pose &pose,
+                                vector<Point2f> &image_points) const {
+    image_points.clear();
+    if (!intrinsics_.valid()) return CALIB_ERR_NOT_CALIBRATED;
+    if (pose.rotate_vec.empty() || pose.tran_vec.empty()) return CALIB_ERR_BAD_ARGUMENT;
+    if (world_points.empty()) return CALIB_OK;
+
+    try {
+        projectPoints(world_points, pose.rotate_vec, pose.tran_vec, intrinsics_.camera_matrix,
+                        intrinsics_.dis_coef, image_points);
+    }
+    catch (const cv::Exception &) {
+        return CALIB_ERR_SOLVER;
+    }
+    return CALIB_OK;
+}
+
+CalibStatus Projector::draw_axes(Mat &canvas, const Pose &pose, float length) const {
+    vector<Vec3f> real_world;
+    real_world.push_back(Vec3f(0, 0, 0));
+    real_world.push_back(Vec3f(0, -length, 0));
+    real_world.push_back(Vec3f(length, 0, 0));
+    real_world.push_back(Vec3f(0, 0, length));
+
+    vector<Point2f> image_points;
+    CalibStatus status = project(real_world, pose, image_points);
+    if (status != CALIB_OK) return status;
+    if (canvas.empty()) return CALIB_ERR_EMPTY_IMAGE;
+
+    try {
+        line(canvas, image_points[0], image_points[1], Scalar(0, 0, 255), 2);
+        line(canvas, image_points[0], image_points[2], Scalar(0, 255, 0), 2);
+        line(canvas, image_points[0], image_points[3], Scalar(255, 0, 0), 2);
+    }
+    catch (const cv::Exception &) {
+        return CALIB_ERR_BAD_ARGUMENT;
+    }
+    return CALIB_OK;
+}
+
+CalibStatus read_obj_mesh(const string &file_name, Mesh &mesh) {
+    FILE *file = fopen(file_name.c_str(), "r");
+    if (file == NULL) return CALIB_ERR_FILE_IO;
+
+    Mesh loaded;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == 'v' && line[1] == ' ') {
+            Vec3f vertex;
+            // obj files are y-up, the board is z-up
+            if (sscanf(line + 2, "%f %f %f", &vertex[0], &vertex[2], &vertex[1]) != 3) {
+                fclose(file);
+                return CALIB_ERR_PARSE;
+            }
+            loaded.v_vec.push_back(vertex);
+        }
+        else if (line[0] == 'f' && line[1] == ' ') {
+            int vertexIndex[3];
+            if (sscanf(line + 2, "%d %d %d", &vertexIndex[0], &vertexIndex[1], &vertexIndex[2]) != 3) {
+                fclose(file);
+                return CALIB_ERR_PARSE;
+            }
+            loaded.v_idx.push_back(vertexIndex[0]);
+            loaded.v_idx.push_back(vertexIndex[1]);
+            loaded.v_idx.push_back(vertexIndex[2]);
+        }
+    }
+    fclose(file);
+
+    if (!valid_mesh(loaded)) return CALIB_ERR_PARSE;
+    mesh = loaded;
+    return CALIB_OK;
+}
+
+MeshRenderer::MeshRenderer(const CameraIntrinsics &intrinsics)
+    : projector_(intrinsics), mesh_(make_shared<Mesh>()) {}
+
+CalibStatus MeshRenderer::load_obj(const string &file_name, bool place_on_board) {
+    Mesh mesh;
+    CalibStatus status = read_obj_mesh(file_name, mesh);
+    if (status != CALIB_OK) return status;
+
+    if (place_on_board && !mesh.v_vec.empty()) {
+        // add some offset to make it sit on the board
+        float min_0 = mesh.v_vec[0][0];
+        float max_1 = mesh.v_vec[0][1];
+        float min_2 = mesh.v_vec[0][2];
+        for (const Vec3f &it: mesh.v_vec) {
+            min_0 = min(min_0, it[0]);
+            max_1 = max(max_1, it[1]);
+            min_2 = min(min_2, it[2]);
+        }
+        for (Vec3f &it: mesh.v_vec) {
+            it[0] -= min_0;
+            it[1] -= max_1;
+            it[2] -= min_2;
+        }
+    }
+    return set_mesh(mesh);
+}
+
+CalibStatus MeshRenderer::set_mesh(const Mesh &mesh) {
+    if (!valid_mesh(mesh)) return CALIB_ERR_BAD_ARGUMENT;
+
+    shared_ptr<const Mesh> replacement = make_shared<Mesh>(mesh);
+    lock_guard<mutex> lock(mutex_);
+    mesh_ = replacement;
+    return CALIB_OK;
+}
+
+CalibStatus MeshRenderer::render(Mat &canvas, const Pose &pose, const Scalar &color, int thickness) const {
+    // renderers hold their own reference, so a concurrent set_mesh never invalidates it
+    shared_ptr<const Mesh> mesh;
+    {
+        lock_guard<mutex> lock(mutex_);
+        mesh = mesh_;
+    }
+
+    vector<Point2f> image_points;
+    CalibStatus status = projector_.project(mesh->v_vec, pose, image_points);
+    if (status != CALIB_OK) return status;
+
+    if (canvas.empty()) return CALIB_ERR_EMPTY_IMAGE;
+
+    // indices were checked by set_mesh
+    const vector<int> &v_idx = mesh->v_idx;
+    try {
+        for (size_t i = 0; i + 2 < v_idx.size(); i += 3) {
+            line(canvas, image_points[v_idx[i] - 1], image_points[v_idx[i + 1] - 1], color, thickness);
+            line(canvas, image_points[v_idx[i + 1] - 1], image_points[v_idx[i + 2] - 1], color, thickness);
+            line(canvas, image_points[v_idx[i + 2] - 1], image_points[v_idx[i] - 1], color, thickness);
+        }
+    }
+    catch (const cv::Exception &) {
+        return CALIB_ERR_BAD_ARGUMENT;
+    }
+    return CALIB_OK;
+}
+
+MultiBoardTracker::MultiBoardTracker(const CameraIntrinsics &intrinsics, const BoardSpec &board,
+                                        int max_targets, int discovery_interval, int max_missed)
+    : detector_(board), estimator_(intrinsics, board), max_targets_(max_targets),
+      discovery_interval_(max(1, discovery_interval)), max_missed_(max_missed), next_id_(0), frame_count_(0) {}
+
+void MultiBoardTracker::reset() {
+    lock_guard<mutex> lock(mutex_);
+    states_.clear();
+    frame_size_ = Size();
+    next_id_ = 0;
+    frame_count_ = 0;
+}
+
+/**
+ * @brief Mean of the corners, the same whichever way round the detector orders them
+ */
+static Point2f centroid_of(const vector<Point2f> &corner_set) {
+    Point2f center(0, 0);
+    for (const Point2f &corner: corner_set) center += corner;
+    return center * (1.0f / corner_set.size());
+}
+
+/**
+ * @brief Diagonal of the board in pixels
+ */
+static float extent_of(const vector<Point2f> &corner_set) {
+    return (float)norm(corner_set.front() - corner_set.back());
+}
+
+/**
+ * @brief Bounding box of a board grown to allow for motion until the next frame
+ */
+Rect MultiBoardTracker::search_region(const vector<Point2f> &corner_set, Size image_size) const {
+    Rect box = boundingRect(corner_set);
+    // findChessboardCorners needs a quiet zone of about one square around the board
+    int squares = max(detector_.board().pattern_size.width, detector_.board().pattern_size.height);
+    int margin = max(box.width, box.height) / max(1, squares - 1) * 2 + max(box.width, box.height) / 4;
+    Rect grown(box.x - margin, box.y - margin, box.width + 2 * margin, box.height + 2 * margin);
+    return grown & Rect(0, 0, image_size.width, image_size.height);
+}
+
+/**
+ * @brief Outer corners of a board grown by roughly one square, filling it hides the whole board
+ */
+vector<Point> MultiBoardTracker::board_hull(const vector<Point2f> &corner_set) const {
+    int w = detector_.board().pattern_size.width;
+    int h = detector_.board().pattern_size.height;
+    Point2f center = centroid_of(corner_set);
+    Point2f outer[4] = {corner_set[0], corner_set[w - 1], corner_set[w * h - 1], corner_set[w * (h - 1)]};
+
+    vector<Point> hull;
+    for (const Point2f &corner: outer) {
+        // the outer corner sits one square inside the board edge, on both axes
+        Point2f grown = center + (corner - center) * (1.0f + 2.0f / max(1, min(w, h) - 1));
+        hull.push_back(Point(cvRound(grown.x), cvRound(grown.y)));
+    }
+    return hull;
+}
+
+MultiBoardTracker::TrackState MultiBoardTracker::make_state(const TrackedTarget &target, Size image_size) const {
+    TrackState state;
+    state.target_id = target.target_id;
+    state.roi = search_region(target.corner_set, image_size);
+    state.missed_frames = 0;
+    state.centroid = centroid_of(target.corner_set);
+    state.extent = extent_of(target.corner_set);
+    state.hull = board_hull(target.corner_set);
+    return state;
+}
+
+/**
+ * @brief Search for the board of one known target inside its previous region
+ */
+bool MultiBoardTracker::search_known(const Mat &gray, size_t index, TrackedTarget &target) const {
+    const TrackState &state = states_[index];
+    Mat region = gray(state.roi);
+
+    // hide the other targets so the region can only return this target's board
+    vector<vector<Point>> others;
+    for (size_t j = 0; j < states_.size(); j++) {
+        if (j != index && (states_[j].roi & state.roi).area() > 0) others.push_back(states_[j].hull);
+    }
+    if (!others.empty()) {
+        region = region.clone();
+        fillPoly(region, others, Scalar(128), LINE_8, 0, -state.roi.tl());
+    }
+
+    vector<Point2f> corner_set;
+    if (detector_.detect(region, corner_set) != CALIB_OK) return false;
+    for (Point2f &corner: corner_set) {
+        corner.x += state.roi.x;
+        corner.y += state.roi.y;
+    }
+    // a board far from the previous one, e.g. a new one entering the region, is left to discovery;
+    // the allowed motion grows with the frames the target was missed, like its region
+    if (norm(centroid_of(corner_set) - state.centroid) > 0.5f * state.extent * (1 + state.missed_frames)) return false;
+
+    target.target_id = state.target_id;
+    target.corner_set = corner_set;
+    estimator_.estimate(corner_set, target.pose);
+    return true;
+}
+
+/**
+ * @brief Search for boards not covered by the known targets, at most limit of them. The whole frame
+ * catches large boards, overlapping half-size tiles catch smaller ones; all are searched in parallel,
+ * one board per tile. Found boards have no id yet.
+ */
+void MultiBoardTracker::discover(const Mat &gray, const vector<TrackedTarget> &known, int limit,
+                                    vector<TrackedTarget> &found) const {
+    found.clear();
+    if (limit <= 0) return;
+
+    Mat masked = gray;
+    if (!known.empty()) {
+        masked = gray.clone();
+        vector<vector<Point>> hulls;
+        for (const TrackedTarget &target: known) hulls.push_back(board_hull(target.corner_set));
+        fillPoly(masked, hulls, Scalar(128));
+    }
+
+    vector<Rect> tiles;
+    tiles.push_back(Rect(0, 0, gray.cols, gray.rows));
+    for (int ty = 0; ty < 3; ty++) {
+        for (int tx = 0; tx < 3; tx++) {
+            tiles.push_back(Rect(tx * gray.cols / 4, ty * gray.rows / 4, gray.cols / 2, gray.rows / 2));
+        }
+    }
+
+    vector<TrackedTarget> hits(tiles.size());
+    parallel_for_(Range(0, (int)tiles.size()), [&](const Range &range) {
+        vector<Point2f> corner_set;
+        for (int i = range.start; i < range.end; i++) {
+            // most tiles hold no new board, the fast check rejects them without the full search
+            if (detector_.detect(masked(tiles[i]), corner_set,
+                    CALIB_CB_ADAPTIVE_THRESH + CALIB_CB_NORMALIZE_IMAGE + CALIB_CB_FAST_CHECK) != CALIB_OK) continue;
+            for (Point2f &corner: corner_set) {
+                corner.x += tiles[i].x;
+                corner.y += tiles[i].y;
+            }
+            hits[i].corner_set = corner_set;
+            estimator_.estimate(corner_set, hits[i].pose);
+        }
+    });
+
+    // overlapping tiles find the same board more than once
+    for (TrackedTarget &hit: hits) {
+        if ((int)found.size() >= limit) break;
+        if (hit.corner_set.empty()) continue;
+
+        Point2f center = centroid_of(hit.corner_set);
+        bool duplicate = false;
+        for (const TrackedTarget &target: found) {
+            if (norm(center - centroid_of(target.corner_set)) < 0.25f * extent_of(target.corner_set)) {
+                duplicate = true;
+                break;
+            }
+        }
+        if (!duplicate) found.push_back(hit);
+    }
+}
+
+CalibStatus MultiBoardTracker::track(const Mat &frame, vector<TrackedTarget> &targets) {
+    targets.clear();
+    if (!estimator_.intrinsics().valid()) return CALIB_ERR_NOT_CALIBRATED;
+
+    Mat gray;
+    CalibStatus status = to_gray(frame, gray);
+    if (status != CALIB_OK) return status;
+
+    lock_guard<mutex> lock(mutex_);
+
+    // regions from a frame of another size do not fit this one, start over
+    if (gray.size() != frame_size_) {
+        states_.clear();
+        frame_size_ = gray.size();
+        frame_count_ = 0;
+    }
+
+    // states_ is only replaced once the whole frame succeeded
+    vector<TrackState> kept;
+    try {
+        // search every known target, missed ones included, inside its own region, one region per worker
+        vector<TrackedTarget> results(states_.size());
+        vector<char> hit(states_.size(), 0);
+        parallel_for_(Range(0, (int)states_.size()), [&](const Range &range) {
+            for (int i = range.start; i < range.end; i++) {
+                hit[i] = search_known(gray, i, results[i]);
+            }
+        });
+
+        // targets whose previous boards overlap can still land on the same board; the older id wins
+        for (size_t i = 0; i < states_.size(); i++) {
+            for (size_t j = 0; j < i && hit[i]; j++) {
+                if (hit[j] && norm(centroid_of(results[i].corner_set) - centroid_of(results[j].corner_set))
+                                < 0.25f * extent_of(results[j].corner_set)) {
+                    hit[i] = 0;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < states_.size(); i++) {
+            if (hit[i]) {
+                kept.push_back(make_state(results[i], gray.size()));
+                targets.push_back(results[i]);
+            }
+            else if (states_[i].missed_frames < max_missed_) {
+                // widen the region of a missed target so it can be found again without the full search
+                TrackState state = states_[i];
+                int grow = max(1, cvRound(state.extent / 4));
+                state.roi = Rect(state.roi.x - grow, state.roi.y - grow,
+                                    state.roi.width + 2 * grow, state.roi.height + 2 * grow)
+                            & Rect(0, 0, gray.cols, gray.rows);
+                state.missed_frames++;
+                kept.push_back(state);
+            }
+        }
+
+        // the full search for new boards runs on its own schedule, its cost does not depend on missed targets
+        if (frame_count_ % discovery_interval_ == 0) {
+            vector<TrackedTarget> found;
+            discover(gray, targets, max_targets_ - (int)targets.size(), found);
+
+            // a missed target found again near where it was lost keeps its id, so its overlay stays bound
+            vector<char> matched(found.size(), 0);
+            for (size_t i = 0; i < found.size(); i++) {
+                Point2f center = centroid_of(found[i].corner_set);
+                int nearest = -1;
+                float nearest_dist = 0;
+                for (size_t j = 0; j < kept.size(); j++) {
+                    if (kept[j].missed_frames == 0) continue;
+                    float dist = (float)norm(kept[j].centroid - center);
+                    if (dist < kept[j].extent && (nearest < 0 || dist < nearest_dist)) {
+                        nearest = (int)j;
+                        nearest_dist = dist;
+                    }
+                }
+                if (nearest < 0) continue;
+                found[i].target_id = kept[nearest].target_id;
+                kept[nearest] = make_state(found[i], gray.size());
+                targets.push_back(found[i]);
+                matched[i] = 1;
+            }
+
+            // genuinely new boards get fresh ids while the kept states, missed ones included, stay in the limit
+            for (size_t i = 0; i < found.size(); i++) {
+                if (matched[i] || (int)kept.size() >= max_targets_) continue;
+                found[i].target_id = next_id_++;
+                kept.push_back(make_state(found[i], gray.size()));
+                targets.push_back(found[i]);
+            }
+        }
+    }
+    catch (const cv::Exception &) {
+        targets.clear();
+        return CALIB_ERR_SOLVER;
+    }
+    states_ = kept;
+    frame_count_++;
+
+    sort(targets.begin(), targets.end(), [](const TrackedTarget &a, const TrackedTarget &b) {
+        return a.target_id < b.target_id;
+    });
+    return CALIB_OK;
+}
+
+void OverlayRegistry::bind(int target_id, shared_ptr<const MeshRenderer> renderer) {
+    lock_guard<mutex> lock(mutex_);
+    bindings_[target_id] = renderer;
+}
+
+void OverlayRegistry::unbind(int target_id) {
+    lock_guard<mutex> lock(mutex_);
+    bindings_.erase(target_id);
+}
+
+CalibStatus OverlayRegistry::render(Mat &canvas, const vector<TrackedTarget> &targets) const {
+    CalibStatus result = CALIB_OK;
+    for (const TrackedTarget &target: targets) {
+        shared_ptr<const MeshRenderer> renderer;
+        {
+            lock_guard<mutex> lock(mutex_);
+            auto it = bindings_.find(target.target_id);
+            if (it != bindings_.end()) renderer = it->second;
+        }
+        if (!renderer || target.pose.rotate_vec.empty()) continue;
+
+        CalibStatus status = renderer->render(canvas, target.pose);
+        if (status != CALIB_OK) result = status;
+    }
+    return result;
+}
+
+}
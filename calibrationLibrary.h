@@ -0,0 +1,336 @@
+/**
+ * @file calibrationLibrary.h
+ * @author Xichen Liu
+ * @brief
+ * Reentrant, UI-free API for chessboard detection, camera calibration, pose estimation and projection.
+ * None of the objects below print, open windows or terminate the process; every failure is reported
+ * through a CalibStatus return code. All objects may be shared between threads.
+ */
+
+#ifndef CALIBRATION_LIBRARY_H
+#define CALIBRATION_LIBRARY_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/calib3d.hpp>
+
+namespace calib {
+
+/**
+ * @brief Return codes of the library, 0 means success
+ */
+enum CalibStatus {
+    CALIB_OK = 0,
+    CALIB_ERR_EMPTY_IMAGE = -1,
+    CALIB_ERR_PATTERN_NOT_FOUND = -2,
+    CALIB_ERR_BAD_ARGUMENT = -3,
+    CALIB_ERR_NOT_ENOUGH_VIEWS = -4,
+    CALIB_ERR_NOT_CALIBRATED = -5,
+    CALIB_ERR_FILE_IO = -6,
+    CALIB_ERR_PARSE = -7,
+    CALIB_ERR_SOLVER = -8
+};
+
+/**
+ * @brief Human readable description of a status code
+ */
+const char *status_string(CalibStatus status);
+
+/**
+ * @brief Geometry of a chessboard target
+ */
+struct BoardSpec {
+    cv::Size pattern_size = cv::Size(9, 6);     // inner corners per row and column
+    float square_size = 1.0f;                   // side of a square in world units
+
+    /**
+     * @brief World coordinates of the corners, row by row, y pointing down the board (negative)
+     */
+    std::vector<cv::Vec3f> object_points() const;
+};
+
+/**
+ * @brief Camera intrinsics: 3x3 camera matrix and distortion coefficients (CV_64F)
+ */
+struct CameraIntrinsics {
+    cv::Mat camera_matrix;
+    cv::Mat dis_coef;
+
+    bool valid() const;
+    CameraIntrinsics clone() const;
+};
+
+/**
+ * @brief Pose of a target relative to the camera (Rodrigues rotation and translation)
+ */
+struct Pose {
+    cv::Mat rotate_vec;
+    cv::Mat tran_vec;
+};
+
+/**
+ * @brief Write intrinsics to a csv file in the same layout as data.csv
+ */
+CalibStatus save_intrinsics_csv(const std::string &filename, const CameraIntrinsics &intrinsics);
+
+/**
+ * @brief Read intrinsics from a csv file in the same layout as data.csv
+ */
+CalibStatus load_intrinsics_csv(const std::string &filename, CameraIntrinsics &intrinsics);
+
+/**
+ * @brief Finds and refines the corners of one chessboard. Immutable after construction.
+ */
+class ChessboardDetector {
+public:
+    explicit ChessboardDetector(const BoardSpec &board = BoardSpec());
+
+    /**
+     * @brief Detect the corners of the board
+     *
+     * @param frame         8-bit BGR, BGRA or grayscale image, other formats return CALIB_ERR_BAD_ARGUMENT
+     * @param corner_set    output corner positions, cleared on failure
+     * @param flags         findChessboardCorners flags, add CALIB_CB_FAST_CHECK where a miss is likely
+     */
+    CalibStatus detect(const cv::Mat &frame, std::vector<cv::Point2f> &corner_set,
+                        int flags = cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_NORMALIZE_IMAGE) const;
+
+    /**
+     * @brief Detect the corners of the board in a high resolution still image.
+     * The board is found on a decimated copy no larger than max_detect_dim, then every corner is
+     * refined with cornerSubPix inside a small tile of the full resolution image.
+     *
+     * @param frame             BGR or grayscale image, grayscale avoids a full-frame conversion
+     * @param corner_set        output corner positions in full resolution coordinates
+     * @param max_detect_dim    longest side of the image used for detection
+     */
+    CalibStatus detect_high_res(const cv::Mat &frame, std::vector<cv::Point2f> &corner_set,
+                                int max_detect_dim = 1280) const;
+
+    /**
+     * @brief Draw detected corners onto an image owned by the caller
+     */
+    CalibStatus draw(cv::Mat &canvas, const std::vector<cv::Point2f> &corner_set, bool pattern_found) const;
+
+    const BoardSpec &board() const { return board_; }
+
+private:
+    CalibStatus refine_high_res(const cv::Mat &gray, std::vector<cv::Point2f> &corner_set, int max_detect_dim) const;
+
+    BoardSpec board_;
+};
+
+/**
+ * @brief Accumulates calibration views and solves for the intrinsics
+ */
+class CameraCalibrator {
+public:
+    explicit CameraCalibrator(const BoardSpec &board = BoardSpec(), int min_views = 5);
+
+    /**
+     * @brief Store one set of detected corners as a calibration view
+     */
+    CalibStatus add_view(const std::vector<cv::Point2f> &corner_set);
+    size_t view_count() const;
+    void clear();
+
+    /**
+     * @brief Calibrate from the stored views
+     *
+     * @param image_size                size of the calibration images
+     * @param intrinsics                output camera matrix and distortion coefficients
+     * @param RMS_reprojection_error    output overall RMS re-projection error
+     */
+    CalibStatus calibrate(cv::Size image_size, CameraIntrinsics &intrinsics, double &RMS_reprojection_error) const;
+
+private:
+    BoardSpec board_;
+    int min_views_;
+    mutable std::mutex mutex_;
+    std::vector<std::vector<cv::Point2f>> corner_list_;
+};
+
+/**
+ * @brief Stream still images from disk into a calibrator, one image in memory at a time.
+ * EXIF orientation is ignored. Only images of the size shared by most files are used; images that cannot
+ * be read or have another size are skipped and counted.
+ *
+ * @param files             image files, all taken with the same camera at the same resolution
+ * @param detector          detector used in high resolution mode
+ * @param calibrator        receives one view per image where the board is found
+ * @param image_size        output size of the images
+ * @param views_added       output number of images that produced a view
+ * @param images_skipped    output number of images that could not be read or had another size
+ * @param max_detect_dim    longest side of the image used for detection
+ * @return                  CALIB_ERR_FILE_IO if no image could be read
+ */
+CalibStatus add_calibration_images(const std::vector<std::string> &files, const ChessboardDetector &detector,
+                                    CameraCalibrator &calibrator, cv::Size &image_size, int &views_added,
+                                    int &images_skipped, int max_detect_dim = 1280);
+
+/**
+ * @brief Solves the pose of a board given a calibrated camera. Immutable after construction.
+ */
+class PoseEstimator {
+public:
+    PoseEstimator(const CameraIntrinsics &intrinsics, const BoardSpec &board = BoardSpec());
+
+    CalibStatus estimate(const std::vector<cv::Point2f> &corner_set, Pose &pose) const;
+
+    const CameraIntrinsics &intrinsics() const { return intrinsics_; }
+
+private:
+    CameraIntrinsics intrinsics_;
+    std::vector<cv::Vec3f> point_set_;
+};
+
+/**
+ * @brief Projects world points into the image. Immutable after construction.
+ */
+class Projector {
+public:
+    explicit Projector(const CameraIntrinsics &intrinsics);
+
+    CalibStatus project(const std::vector<cv::Vec3f> &world_points, const Pose &pose,
+                        std::vector<cv::Point2f> &image_points) const;
+
+    /**
+     * @brief Draw the 3D axes (x red, y green, z blue) at the board origin
+     */
+    CalibStatus draw_axes(cv::Mat &canvas, const Pose &pose, float length = 3.0f) const;
+
+private:
+    CameraIntrinsics intrinsics_;
+};
+
+/**
+ * @brief Triangle mesh loaded from an obj file
+ */
+struct Mesh {
+    std::vector<cv::Vec3f> v_vec;   // vertex positions
+    std::vector<int> v_idx;         // 1-based vertex indices, three per face
+};
+
+/**
+ * @brief Renders a wireframe mesh on a target. The mesh can be replaced while other threads render.
+ */
+class MeshRenderer {
+public:
+    explicit MeshRenderer(const CameraIntrinsics &intrinsics);
+
+    /**
+     * @brief Load an obj file, optionally shifting it so it sits on the board corner
+     */
+    CalibStatus load_obj(const std::string &file_name, bool place_on_board = true);
+
+    /**
+     * @brief Replace the mesh, faces must be triangles with 1-based indices of existing vertices
+     */
+    CalibStatus set_mesh(const Mesh &mesh);
+
+    CalibStatus render(cv::Mat &canvas, const Pose &pose, const cv::Scalar &color = cv::Scalar(0, 0, 255),
+                       int thickness = 1) const;
+
+private:
+    Projector projector_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<const Mesh> mesh_;
+};
+
+/**
+ * @brief Parse an obj file into a mesh (vertices and triangular faces only)
+ */
+CalibStatus read_obj_mesh(const std::string &file_name, Mesh &mesh);
+
+/**
+ * @brief One board instance tracked across frames
+ */
+struct TrackedTarget {
+    int target_id = -1;                     // stable while the board stays in view
+    std::vector<cv::Point2f> corner_set;    // corners in the current frame
+    Pose pose;                              // empty when the pose could not be solved
+};
+
+/**
+ * @brief Finds every instance of a board in a video stream and tracks each one with its own id and pose.
+ * Known targets are searched only inside their region from the previous frame, one worker per region,
+ * with the other targets masked out; a missed target is searched in a region that widens each frame.
+ * New targets are searched every discovery_interval frames in overlapping tiles spread across workers.
+ * Use one tracker per stream, concurrent calls to track() on the same tracker are serialized; a change of
+ * frame size starts the tracking over.
+ */
+class MultiBoardTracker {
+public:
+    MultiBoardTracker(const CameraIntrinsics &intrinsics, const BoardSpec &board = BoardSpec(),
+                        int max_targets = 8, int discovery_interval = 10, int max_missed = 5);
+
+    /**
+     * @brief Detect, track and solve the pose of all boards in a frame
+     *
+     * @param frame     BGR or grayscale video frame
+     * @param targets   output targets found in this frame, ordered by id
+     */
+    CalibStatus track(const cv::Mat &frame, std::vector<TrackedTarget> &targets);
+
+    /**
+     * @brief Forget all targets, ids restart from 0
+     */
+    void reset();
+
+private:
+    struct TrackState {
+        int target_id;
+        cv::Rect roi;                   // search region for the next frame
+        int missed_frames;
+        cv::Point2f centroid;           // board center when last seen
+        float extent;                   // board diagonal in pixels when last seen
+        std::vector<cv::Point> hull;    // polygon that hides the board from other searches
+    };
+
+    cv::Rect search_region(const std::vector<cv::Point2f> &corner_set, cv::Size image_size) const;
+    std::vector<cv::Point> board_hull(const std::vector<cv::Point2f> &corner_set) const;
+    TrackState make_state(const TrackedTarget &target, cv::Size image_size) const;
+    bool search_known(const cv::Mat &gray, size_t index, TrackedTarget &target) const;
+    void discover(const cv::Mat &gray, const std::vector<TrackedTarget> &known, int limit,
+                    std::vector<TrackedTarget> &found) const;
+
+    ChessboardDetector detector_;
+    PoseEstimator estimator_;
+    int max_targets_;
+    int discovery_interval_;
+    int max_missed_;
+
+    std::mutex mutex_;
+    std::vector<TrackState> states_;
+    cv::Size frame_size_;               // size of the frames the regions belong to
+    int next_id_;
+    long frame_count_;
+};
+
+/**
+ * @brief Binds overlays to target ids so each tracked board carries its own virtual object
+ */
+class OverlayRegistry {
+public:
+    void bind(int target_id, std::shared_ptr<const MeshRenderer> renderer);
+    void unbind(int target_id);
+
+    /**
+     * @brief Render the overlay bound to each target, targets without a binding are skipped
+     */
+    CalibStatus render(cv::Mat &canvas, const std::vector<TrackedTarget> &targets) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::map<int, std::shared_ptr<const MeshRenderer>> bindings_;
+};
+
+}
+
+#endif
@@ -8,7 +8,7 @@
 #include <stdio.h>
 #include <opencv.hpp>
 #include <calib3d/calib3d.hpp>
-#include "calibrationFunctions.cpp"
+#include "calibrationFunctions.h"
 
 using namespace std;
 using namespace cv;